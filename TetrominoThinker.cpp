@@ -1,5 +1,6 @@
 #include <iostream>
 #include <vector>
+#include <string>
 #include <array>
 #include <algorithm>
 #include <random>
@@ -8,22 +9,56 @@
 #include <cstdlib>
 #include <cmath>
 #include <numeric>
-#include <map>
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_set>
+#include <type_traits>
+#include <cassert>
 
 // --- Platform-specific includes ------------------------------------------------
 #ifdef _WIN32
 #include <io.h>
 #include <fcntl.h>
 #endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
 
 // =============================================================================
 // Configuration & Constants (centralized for easy tuning)
 // =============================================================================
 namespace Config {
     constexpr int W = 10;                     // Board width
-    constexpr int H = 20;                     // Board height (visible rows)
+    constexpr int H = 40;                     // Board height, hidden buffer zone included
+    constexpr int VISIBLE_H = 20;             // Visible rows; taller boards hide the rest above them
     constexpr int PIECE_COUNT = 7;            // Number of Tetromino types
     constexpr int LOOKAHEAD_DEPTH = 3;        // How many upcoming pieces the AI considers
+    constexpr bool TRACK_COLUMNS = true;      // Keep a column-major mirror of the board
+    constexpr bool INCREMENTAL_FEATURES = true; // Keep the heuristic features up to date in BoardState
+#ifdef NDEBUG
+    constexpr bool CHECK_FEATURES = false;    // Recompute incremental features with the kernels
+#else
+    constexpr bool CHECK_FEATURES = true;
+#endif
+    constexpr int HASH_WORDS = 1;             // Zobrist key width in 64-bit words (2 = 128-bit)
+    constexpr size_t TT_MEGABYTES = 16;       // Default transposition table budget
+    constexpr int SEARCH_THREADS = 1;         // Default search thread count
+    constexpr int BEAM_WIDTH = 64;            // Boards kept per ply by the beam search
+    constexpr int BEAM_DEPTH = 6;             // Plies searched by the beam search
+    constexpr int MOVE_BUDGET_MS = 15;        // Per-move search budget in the demo
+    constexpr int CHANCE_DEPTH = 1;           // Expectimax plies past the preview
+    constexpr int CHANCE_SAMPLES = 3;         // Pieces averaged per chance node
+    constexpr bool USE_HOLD = true;           // Search the hold piece as an alternative
+    constexpr unsigned DEADLINE_POLL_NODES = 32;   // Nodes between clock reads
 
     // Heuristic weights – tuned values from well-known strong Tetris AIs
     struct Weights {
@@ -35,14 +70,24 @@ namespace Config {
         double LINES_CLEARED     =  0.9;      // Reward for clearing lines
     };
     constexpr Weights HEURISTIC_WEIGHTS{};    // Immutable default instance
+
+    // Weight policies for BasicTetrisHeuristic: chosen at construction, or fixed at compile time
+    struct RuntimeWeights {
+        Weights weights;
+        RuntimeWeights(Weights w = HEURISTIC_WEIGHTS) : weights(w) {}
+        const Weights& get() const { return weights; }
+    };
+    struct DefaultWeights {
+        static constexpr Weights get() { return HEURISTIC_WEIGHTS; }
+    };
 }
 
 // =============================================================================
-// Tetromino definitions (SRS-compliant kick data omitted for brevity)
+// Tetromino definitions (SRS rotation states; I sits one row higher, see Movegen)
 // =============================================================================
 enum class Piece { I = 0, O, T, S, Z, J, L, Count };
 
-const std::array<std::array<std::array<std::pair<int,int>,4>,4>, Config::PIECE_COUNT> PIECES{{
+constexpr std::array<std::array<std::array<std::pair<int,int>,4>,4>, Config::PIECE_COUNT> PIECES{{
     // I
     {{{{ {0,0},{1,0},{2,0},{3,0} }}, {{ {1,-1},{1,0},{1,1},{1,2} }}, {{ {0,0},{1,0},{2,0},{3,0} }}, {{ {1,-1},{1,0},{1,1},{1,2} }}}},
     // O (no rotation)
@@ -59,178 +104,1948 @@ const std::array<std::array<std::array<std::pair<int,int>,4>,4>, Config::PIECE_C
     {{{{ {2,0},{0,1},{1,1},{2,1} }}, {{ {1,0},{1,1},{1,2},{2,2} }}, {{ {0,1},{1,1},{2,1},{0,2} }}, {{ {0,0},{1,0},{1,1},{1,2} }}}}
 }};
 
-struct Move { int rot = -1, col = -1; double score = -1e12; };
+struct Move {
+    int rot = -1, col = -1, row = -1;         // Final resting position (may be a tuck or spin)
+    double score = -1e12;
+    bool hold = false;                        // Swap with the hold slot before placing
+};
+
+using Clock = std::chrono::steady_clock;
+
+enum class Parallelism {
+    LazySMP,                                  // Threads search the whole root, sharing the table
+    RootSplit                                 // Root placements are split across a thread pool
+};
+
+// Contents of the 7-bag still to be drawn after the preview
+struct BagState {
+    static constexpr uint8_t FULL = (1 << Config::PIECE_COUNT) - 1;
+
+    uint8_t remaining = FULL;                 // Bit p set: piece p is still in the bag
+    uint8_t position = 0;                     // Pieces already drawn from the bag
+
+    bool contains(int piece) const { return remaining & (1 << piece); }
+
+    // State after drawing `piece`; an emptied bag is refilled
+    BagState after(int piece) const {
+        const uint8_t left = remaining & ~(1 << piece);
+        if (!left) return BagState{};
+        return {left, static_cast<uint8_t>(position + 1)};
+    }
+
+    uint64_t key() const { return static_cast<uint64_t>(remaining) | static_cast<uint64_t>(position) << 8; }
+};
+
+struct SearchOptions {
+    int threads = Config::SEARCH_THREADS;     // Worker threads including the caller
+    Parallelism mode = Parallelism::LazySMP;
+    int split_depth = 1;                      // RootSplit: 1 = root placements, 2 = their children too
+    Clock::time_point deadline = Clock::time_point::max();   // Hard per-move deadline (none by default)
+    int chance_depth = Config::CHANCE_DEPTH;  // Expectimax plies after the last preview piece
+    int chance_samples = Config::CHANCE_SAMPLES;
+    BagState bag;                             // Bag after the preview, see PieceGenerator::bag_state
+    bool use_hold = Config::USE_HOLD;         // Let every ply swap with the hold slot
+    int hold = -1;                            // Piece in the hold slot (-1 = empty)
+};
+
+// =============================================================================
+// Bit helpers (compiler intrinsics with a portable MSVC path)
+// =============================================================================
+namespace Bits {
+    inline int popcount(uint32_t v) {
+#ifdef _MSC_VER
+        return static_cast<int>(__popcnt(v));
+#else
+        return __builtin_popcount(v);
+#endif
+    }
+
+    inline int popcount(uint64_t v) {
+#ifdef _MSC_VER
+        return static_cast<int>(__popcnt64(v));
+#else
+        return __builtin_popcountll(v);
+#endif
+    }
+
+    // Index of the highest set bit plus one (0 for v == 0)
+    inline int bit_length(uint32_t v) {
+        if (!v) return 0;
+#ifdef _MSC_VER
+        unsigned long idx;
+        _BitScanReverse(&idx, v);
+        return static_cast<int>(idx) + 1;
+#else
+        return 32 - __builtin_clz(v);
+#endif
+    }
+
+    inline int bit_length(uint64_t v) {
+        if (!v) return 0;
+#ifdef _MSC_VER
+        unsigned long idx;
+        _BitScanReverse64(&idx, v);
+        return static_cast<int>(idx) + 1;
+#else
+        return 64 - __builtin_clzll(v);
+#endif
+    }
+
+    // Index of the lowest set bit (v != 0)
+    inline int trailing_zeros(uint32_t v) {
+#ifdef _MSC_VER
+        unsigned long idx;
+        _BitScanForward(&idx, v);
+        return static_cast<int>(idx);
+#else
+        return __builtin_ctz(v);
+#endif
+    }
+
+    inline int trailing_zeros(uint64_t v) {
+#ifdef _MSC_VER
+        unsigned long idx;
+        _BitScanForward64(&idx, v);
+        return static_cast<int>(idx);
+#else
+        return __builtin_ctzll(v);
+#endif
+    }
+
+    // Extends every set bit of `gen` toward bit 0 through the runs of `pro`
+    // (Kogge-Stone occluded fill, 32-bit)
+    inline uint32_t fill_down(uint32_t gen, uint32_t pro) {
+        gen |= pro & (gen >> 1);  pro &= pro >> 1;
+        gen |= pro & (gen >> 2);  pro &= pro >> 2;
+        gen |= pro & (gen >> 4);  pro &= pro >> 4;
+        gen |= pro & (gen >> 8);  pro &= pro >> 8;
+        gen |= pro & (gen >> 16);
+        return gen;
+    }
+
+    // Same toward the high bits, for gen inside pro: adding gen carries through
+    // each run from its lowest gen bit to the run's end
+    inline uint32_t fill_up(uint32_t gen, uint32_t pro) {
+        return (((pro + gen) ^ pro) & pro) | gen;
+    }
+
+    // Shift left by s, right for negative s
+    template <class Word>
+    inline Word shift(Word v, int s) { return s >= 0 ? v << s : v >> -s; }
+}
+
+// =============================================================================
+// Piece masks – row bitmasks for every (piece, rotation, column), built at
+// compile time per board width so collision and placement are a handful of
+// ANDs / ORs
+// =============================================================================
+template <int W>
+struct PieceMasks {
+    static constexpr int COL_MIN = -3;                   // Leftmost column the search tries
+    static constexpr int COLS    = W - COL_MIN;          // Columns per rotation
+
+    struct Shape {
+        int top    = 0;                                  // dy of the shape's first row
+        int height = 0;                                  // Rows spanned (1..4)
+        int left   = 0;                                  // dx of the shape's first column
+        int width  = 0;                                  // Columns spanned (1..4)
+        std::array<int, 4> col_top{};                    // Highest dy per column (from left)
+        std::array<int, 4> bottom{};                     // Lowest dy per column – the drop profile
+        std::array<bool, COLS> fits{};                   // All cells inside [0, W) at this column
+        uint32_t fit_mask = 0;                           // fits[] as a word, bit c = column c
+        std::array<std::array<int, 4>, COLS> rows{};     // Row masks, indexed by px - COL_MIN
+    };
+
+    static constexpr std::array<std::array<Shape, 4>, Config::PIECE_COUNT> build() {
+        std::array<std::array<Shape, 4>, Config::PIECE_COUNT> t{};
+        for (int p = 0; p < Config::PIECE_COUNT; ++p) {
+            for (int r = 0; r < 4; ++r) {
+                Shape& s = t[p][r];
+                int top = 4, bottom = -4;
+                for (const auto& cell : PIECES[p][r]) {
+                    top    = std::min(top, cell.second);
+                    bottom = std::max(bottom, cell.second);
+                }
+                s.top = top;
+                s.height = bottom - top + 1;
+
+                int left = 4, right = -4;
+                for (const auto& cell : PIECES[p][r]) {
+                    left  = std::min(left, cell.first);
+                    right = std::max(right, cell.first);
+                }
+                s.left = left;
+                s.width = right - left + 1;
+                for (int i = 0; i < 4; ++i) { s.col_top[i] = 4; s.bottom[i] = -4; }
+                for (const auto& cell : PIECES[p][r]) {
+                    int i = cell.first - left;
+                    s.col_top[i] = std::min(s.col_top[i], cell.second);
+                    s.bottom[i]  = std::max(s.bottom[i], cell.second);
+                }
+
+                for (int c = 0; c < COLS; ++c) {
+                    bool fits = true;
+                    for (const auto& cell : PIECES[p][r]) {
+                        int x = c + COL_MIN + cell.first;
+                        if (x < 0 || x >= W) fits = false;
+                    }
+                    s.fits[c] = fits;
+                    if (!fits) continue;
+                    s.fit_mask |= 1u << c;
+                    for (const auto& cell : PIECES[p][r])
+                        s.rows[c][cell.second - top] |= 1 << (c + COL_MIN + cell.first);
+                }
+            }
+        }
+        return t;
+    }
+
+    static constexpr std::array<std::array<Shape, 4>, Config::PIECE_COUNT> TABLE = build();
+
+    // Rotations whose cells are a translation of an earlier rotation (O x3, I/S/Z x1)
+    // collapse onto it: same rows, anchor column shifted by `dx`
+    struct Canonical { int rot, dx; };
+
+    // Normalized shape as a 4x4 cell mask, equal for rotations that differ by a shift
+    static constexpr int shape_bits(int p, int r) {
+        int bits = 0;
+        for (const auto& cell : PIECES[p][r])
+            bits |= 1 << ((cell.second - TABLE[p][r].top) * 4 + (cell.first - TABLE[p][r].left));
+        return bits;
+    }
+
+    static constexpr std::array<std::array<Canonical, 4>, Config::PIECE_COUNT> build_canonical() {
+        std::array<std::array<Canonical, 4>, Config::PIECE_COUNT> t{};
+        for (int p = 0; p < Config::PIECE_COUNT; ++p) {
+            for (int r = 0; r < 4; ++r) {
+                int q = 0;
+                while (shape_bits(p, q) != shape_bits(p, r)) ++q;
+                t[p][r] = {q, TABLE[p][r].left - TABLE[p][q].left};
+            }
+        }
+        return t;
+    }
+
+    static constexpr std::array<std::array<Canonical, 4>, Config::PIECE_COUNT> CANONICAL = build_canonical();
+};
+
+using Masks = PieceMasks<Config::W>;
+
+// =============================================================================
+// SRS rotation system – kick tests and spawn positions in our piece frame
+// =============================================================================
+namespace Srs {
+    // SRS kick tests per [from rotation][clockwise, counter-clockwise], x right and
+    // y up as in the guideline tables
+    constexpr int KICK_TESTS = 5;
+    using KickTable = std::array<std::array<std::array<std::pair<int,int>, KICK_TESTS>, 2>, 4>;
+
+    constexpr KickTable JLSTZ_KICKS{{
+        {{ {{ {0,0},{-1,0},{-1, 1},{0,-2},{-1,-2} }}, {{ {0,0},{ 1,0},{ 1, 1},{0,-2},{ 1,-2} }} }},
+        {{ {{ {0,0},{ 1,0},{ 1,-1},{0, 2},{ 1, 2} }}, {{ {0,0},{ 1,0},{ 1,-1},{0, 2},{ 1, 2} }} }},
+        {{ {{ {0,0},{ 1,0},{ 1, 1},{0,-2},{ 1,-2} }}, {{ {0,0},{-1,0},{-1, 1},{0,-2},{-1,-2} }} }},
+        {{ {{ {0,0},{-1,0},{-1,-1},{0, 2},{-1, 2} }}, {{ {0,0},{-1,0},{-1,-1},{0, 2},{-1, 2} }} }}
+    }};
+
+    constexpr KickTable I_KICKS{{
+        {{ {{ {0,0},{-2,0},{ 1,0},{-2,-1},{ 1, 2} }}, {{ {0,0},{-1,0},{ 2,0},{-1, 2},{ 2,-1} }} }},
+        {{ {{ {0,0},{-1,0},{ 2,0},{-1, 2},{ 2,-1} }}, {{ {0,0},{ 2,0},{-1,0},{ 2, 1},{-1,-2} }} }},
+        {{ {{ {0,0},{ 2,0},{-1,0},{ 2, 1},{-1,-2} }}, {{ {0,0},{ 1,0},{-2,0},{ 1,-2},{-2, 1} }} }},
+        {{ {{ {0,0},{ 1,0},{-2,0},{ 1,-2},{-2, 1} }}, {{ {0,0},{-2,0},{ 1,0},{-2,-1},{ 1, 2} }} }}
+    }};
+
+    // Offset from our I anchor to its SRS 4x4 box (JLSTZ and O already line up)
+    constexpr std::array<std::pair<int,int>, 4> I_BOX{{ {0,-1}, {-1,-1}, {0,-2}, {0,-1} }};
+
+    struct Kick { int dc, dt; };                   // Anchor column and top-row deltas
+    struct Turn {
+        int to = 0;                                // Rotation after the turn
+        int tests = 0;                             // Kick tests, tried in order
+        std::array<Kick, KICK_TESTS> kicks{};
+    };
+
+    constexpr std::array<std::array<std::array<Turn, 2>, 4>, Config::PIECE_COUNT> build_turns() {
+        std::array<std::array<std::array<Turn, 2>, 4>, Config::PIECE_COUNT> t{};
+        const int I = static_cast<int>(Piece::I), O = static_cast<int>(Piece::O);
+        for (int p = 0; p < Config::PIECE_COUNT; ++p) {
+            for (int r = 0; r < 4; ++r) {
+                for (int d = 0; d < 2; ++d) {
+                    Turn& turn = t[p][r][d];
+                    turn.to = (r + (d ? 3 : 1)) % 4;
+                    turn.tests = p == O ? 1 : KICK_TESTS;   // O never moves when turned
+                    for (int k = 0; k < turn.tests; ++k) {
+                        auto [kx, ky] = (p == I ? I_KICKS : JLSTZ_KICKS)[r][d][k];
+                        int dx = kx, dy = -ky;
+                        if (p == I) {
+                            dx += I_BOX[r].first - I_BOX[turn.to].first;
+                            dy += I_BOX[r].second - I_BOX[turn.to].second;
+                        }
+                        // Top row moves by dy plus the change in the shape's own top
+                        // (shape extents do not depend on the board width)
+                        turn.kicks[k] = {dx, dy + Masks::TABLE[p][turn.to].top - Masks::TABLE[p][r].top};
+                    }
+                }
+            }
+        }
+        return t;
+    }
+
+    constexpr auto TURNS = build_turns();
+
+    // Guideline spawn column: centred, rounded left. The spawn row depends on the
+    // board's buffer zone, see BasicBoardState::spawn_top() / spawn_row().
+    template <int W = Config::W>
+    constexpr int spawn_col(int p) {
+        return (W - Masks::TABLE[p][0].width) / 2 - Masks::TABLE[p][0].left;
+    }
+}
+
+// =============================================================================
+// Zobrist keys – one random word per cell, folded into half-row lookup tables
+// so a whole row mask hashes with two loads
+// =============================================================================
+namespace Zobrist {
+    struct Key {
+        std::array<uint64_t, Config::HASH_WORDS> w{};
+
+        Key& operator^=(const Key& o) {
+            for (int i = 0; i < Config::HASH_WORDS; ++i) w[i] ^= o.w[i];
+            return *this;
+        }
+        bool operator==(const Key& o) const { return w == o.w; }
+    };
+
+    constexpr uint64_t splitmix64(uint64_t& state) {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // Row keys of a W x H board
+    template <int W, int H>
+    struct RowKeys {
+        static constexpr int HALF = (W + 1) / 2;         // Columns covered by the low table
+
+        struct Tables {
+            std::array<std::array<Key, 1 << HALF>, H> lo{}, hi{};
+        };
+
+        static constexpr Tables build() {
+            Tables t{};
+            uint64_t seed = 0x7E7A0D1CEull;
+            for (int y = 0; y < H; ++y) {
+                for (int x = 0; x < W; ++x) {
+                    std::array<uint64_t, Config::HASH_WORDS> cell{};
+                    for (auto& word : cell) word = splitmix64(seed);
+
+                    auto& half = x < HALF ? t.lo[y] : t.hi[y];
+                    const int bit = 1 << (x < HALF ? x : x - HALF);
+                    for (int m = 0; m < (1 << HALF); ++m)
+                        if (m & bit)
+                            for (int i = 0; i < Config::HASH_WORDS; ++i) half[m].w[i] ^= cell[i];
+                }
+            }
+            return t;
+        }
+
+        static constexpr Tables TABLES = build();
+
+        // Key contribution of the cells in `mask` on row y (XOR-linear in the mask)
+        static Key row_key(int y, int mask) {
+            Key k = TABLES.lo[y][mask & ((1 << HALF) - 1)];
+            k ^= TABLES.hi[y][mask >> HALF];
+            return k;
+        }
+    };
+}
 
 // =============================================================================
-// BoardState – compact bitwise representation (10-bit rows)
+// PackedBoard – the whole grid in as few 64-bit words as hold it (256 bits for
+// 10x20), cell (x, y) at bit y*W + x, so a row shift is one multi-word shift
+// and whole-board masks are a few word ops
 // =============================================================================
-class BoardState {
-    std::array<int, Config::H> data;               // Each int holds a row's bitmask
+template <int W, int H>
+struct BasicPackedBoard {
+    static constexpr int CELLS = W * H;
+    static constexpr int WORDS = (CELLS + 63) / 64;
+
+    std::array<uint64_t, WORDS> w{};
+
+    bool operator==(const BasicPackedBoard& o) const { return w == o.w; }
+    bool operator!=(const BasicPackedBoard& o) const { return w != o.w; }
+
+    bool test(int x, int y) const {
+        const int bit = y * W + x;
+        return (w[bit >> 6] >> (bit & 63)) & 1;
+    }
+
+    int count() const {
+        int n = 0;
+        for (uint64_t word : w) n += Bits::popcount(word);
+        return n;
+    }
+
+    // Contents moved `rows` rows down (toward higher y); cells past the floor drop out
+    BasicPackedBoard shifted_down(int rows) const {
+        const int n = rows * W, q = n >> 6, b = n & 63;
+        BasicPackedBoard out;
+        for (int i = WORDS - 1; i >= q; --i) {
+            out.w[i] = w[i - q] << b;
+            if (b && i - q > 0) out.w[i] |= w[i - q - 1] >> (64 - b);
+        }
+        if constexpr (CELLS % 64) out.w[CELLS / 64] &= (uint64_t{1} << (CELLS % 64)) - 1;
+        return out;
+    }
+
+    BasicPackedBoard& operator|=(const BasicPackedBoard& o) {
+        for (int i = 0; i < WORDS; ++i) w[i] |= o.w[i];
+        return *this;
+    }
+
+    // Empty cells with a block somewhere above them
+    BasicPackedBoard holes() const {
+        BasicPackedBoard covered = shifted_down(1);
+        for (int rows = 1; rows < H; rows *= 2) covered |= covered.shifted_down(rows);
+        for (int i = 0; i < WORDS; ++i) covered.w[i] &= ~w[i];
+        return covered;
+    }
+};
+
+using PackedBoard = BasicPackedBoard<Config::W, Config::H>;
 
+// =============================================================================
+// BoardState – compact bitwise representation, one narrow word per row
+// =============================================================================
+// Integer board features the heuristic weighs
+struct BoardFeatures {
+    int height_sum = 0, holes = 0, bumpiness = 0, max_h = 0, wells = 0;
+
+    bool operator==(const BoardFeatures& o) const {
+        return height_sum == o.height_sum && holes == o.holes && bumpiness == o.bumpiness
+            && max_h == o.max_h && wells == o.wells;
+    }
+};
+
+// Word layout of a W x H board: the narrowest words that hold a row, a column
+// and a set of rows (10x20: 16-bit rows, 32-bit columns; 10x40: 64-bit
+// columns; 4-wide: 8-bit rows)
+template <int W, int H>
+struct BoardLayout {
+    static_assert(W >= 4 && W <= 16, "Rows are stored as at most 16-bit masks");
+    static_assert(H >= 4 && H <= 64, "Columns are stored as at most 64-bit masks");
+    using Row    = std::conditional_t<W <= 8, uint8_t, uint16_t>;
+    using Column = std::conditional_t<H <= 32, uint32_t, uint64_t>;
+    using RowSet = Column;                         // One bit per row
+};
+
+template <int W, int H>
+class BasicBoardState {
 public:
-    BoardState() { data.fill(0); }
-    BoardState(const BoardState& o) : data(o.data) {}
+    static constexpr int WIDTH = W, HEIGHT = H;
+    static constexpr int VISIBLE = std::min(H, Config::VISIBLE_H);
+    static constexpr int BUFFER  = H - VISIBLE;    // Hidden rows above the visible field
+    using Row    = typename BoardLayout<W, H>::Row;
+    using Column = typename BoardLayout<W, H>::Column;
+    using RowSet = typename BoardLayout<W, H>::RowSet;
+    using Masks  = PieceMasks<W>;
+    using PackedBoard = BasicPackedBoard<W, H>;
 
-    // Simple hash for transposition table
-    size_t hash() const {
-        size_t h = 0;
-        for (int r : data) h = h * 31 + r;
-        return h;
+    // Piece positions of one rotation: a word per shape top row, bit c = anchor column c + COL_MIN
+    using PositionMask = std::array<uint32_t, H>;
+
+private:
+    using Keys = Zobrist::RowKeys<W, H>;
+
+    std::array<Row, H> data;                       // Each row's bitmask, bit x = column x
+    std::array<uint8_t, W> heights;                // Skyline: filled height of each column (H <= 64)
+    std::array<Column, W> columns;                 // Column-major mirror, bit H-1-y = row y
+    Zobrist::Key zkey;                             // Incrementally maintained board key
+    BoardFeatures feats;                           // Running features (INCREMENTAL_FEATURES)
+    int cells = 0;                                 // Filled cells, so holes = height_sum - cells
+
+    // Column x's share of bumpiness (the pair x, x+1) and of wells
+    int bump_at(int x) const { return x < W - 1 ? std::abs(heights[x] - heights[x + 1]) : 0; }
+    int well_at(int x) const {
+        const int left  = x == 0             ? H : heights[x - 1];
+        const int right = x == W - 1 ? H : heights[x + 1];
+        return heights[x] < left && heights[x] < right ? std::min(left, right) - heights[x] : 0;
     }
 
-    // Collision test using bitwise operations
-    bool collides(int px, int py, int p, int r) const {
-        for (auto [dx, dy] : PIECES[p][r]) {
-            int x = px + dx;
-            int y = py + dy;
-            if (x < 0 || x >= Config::W || y >= Config::H) return true;
-            if (y >= 0 && (data[y] & (1 << x))) return true;
+    // Adds (sign 1) or takes out (sign -1) the bumpiness and well terms of columns lo..hi
+    void column_terms(int lo, int hi, int sign) {
+        for (int x = lo; x <= hi; ++x) { feats.bumpiness += sign * bump_at(x); feats.wells += sign * well_at(x); }
+    }
+
+    void recompute_features() {
+        feats = {};
+        for (int x = 0; x < W; ++x) {
+            feats.height_sum += heights[x];
+            feats.max_h = std::max<int>(feats.max_h, heights[x]);
+            feats.bumpiness += bump_at(x);
+            feats.wells += well_at(x);
+        }
+        feats.holes = feats.height_sum - cells;
+    }
+
+    void recompute_heights() {
+        if constexpr (Config::TRACK_COLUMNS) {
+            for (int x = 0; x < W; ++x) heights[x] = static_cast<uint8_t>(Bits::bit_length(columns[x]));
+            return;
+        }
+        heights.fill(0);
+        int seen = 0;
+        for (int y = 0; y < H && seen != (1 << W) - 1; ++y) {
+            int fresh = data[y] & ~seen;
+            for (int x = 0; fresh; ++x, fresh >>= 1)
+                if (fresh & 1) heights[x] = static_cast<uint8_t>(H - y);
+            seen |= data[y];
+        }
+    }
+
+    // Removes the full rows among lo..hi (only those can have filled up) and
+    // returns them as bit y = row y. Nothing full: no compaction at all.
+    RowSet remove_full_rows(int lo, int hi) {
+        constexpr int FULL = (1 << W) - 1;
+        RowSet removed = 0;
+        for (int y = lo; y <= hi; ++y)
+            if (data[y] == FULL) removed |= RowSet{1} << y;
+        if (!removed) return 0;
+
+        // Compact the band, then block-move everything above it down by `lines`
+        int dst = hi;
+        for (int src = hi; src >= lo; --src) {
+            const int row = data[src];
+            if (row == FULL) {
+                zkey ^= Keys::row_key(src, row);
+                continue;
+            }
+            if (src != dst) {
+                data[dst] = static_cast<Row>(row);
+                zkey ^= Keys::row_key(src, row);
+                zkey ^= Keys::row_key(dst, row);
+            }
+            --dst;
+        }
+        const int lines = Bits::popcount(removed);
+        for (int y = lo - 1; y >= 0; --y) {
+            if (!data[y]) continue;                // Row moves down: rekey it
+            zkey ^= Keys::row_key(y, data[y]);
+            zkey ^= Keys::row_key(y + lines, data[y]);
+        }
+        std::memmove(&data[lines], &data[0], lo * sizeof(data[0]));
+        std::fill(data.begin(), data.begin() + lines, Row{0});
+        cells -= lines * W;
+
+        if constexpr (Config::TRACK_COLUMNS) {
+            // Drop the cleared bits from every column, highest first so lower indices stay valid
+            for (int b = H - 1 - lo; b >= H - 1 - hi; --b) {
+                if (!(removed & (RowSet{1} << (H - 1 - b)))) continue;
+                const Column below = (Column{1} << b) - 1;
+                for (Column& col : columns) col = (col & below) | ((col >> 1) & ~below);
+            }
+        }
+        recompute_heights();
+        if constexpr (Config::INCREMENTAL_FEATURES) recompute_features();
+        return removed;
+    }
+
+    // Rows a placement covers on the board, for remove_full_rows
+    static std::pair<int, int> touched_rows(int py, int p, int r) {
+        const typename Masks::Shape& s = Masks::TABLE[p][r];
+        return {std::max(py + s.top, 0), std::min(py + s.top + s.height, H) - 1};
+    }
+
+public:
+    BasicBoardState() { data.fill(0); heights.fill(0); columns.fill(0); }
+
+    explicit BasicBoardState(const PackedBoard& p) : BasicBoardState() {
+        for (int y = 0; y < H; ++y) {
+            for (int x = 0; x < W; ++x) {
+                if (!p.test(x, y)) continue;
+                data[y] |= 1 << x;
+                if constexpr (Config::TRACK_COLUMNS) columns[x] |= Column{1} << (H - 1 - y);
+            }
+            if (data[y]) zkey ^= Keys::row_key(y, data[y]);
         }
+        cells = p.count();
+        recompute_heights();
+        if constexpr (Config::INCREMENTAL_FEATURES) recompute_features();
+    }
+    BasicBoardState(const BasicBoardState& o)
+        : data(o.data), heights(o.heights), columns(o.columns), zkey(o.zkey), feats(o.feats), cells(o.cells) {}
+    BasicBoardState& operator=(const BasicBoardState&) = default;
+
+    // Zobrist hash for the transposition table (first key word)
+    size_t hash() const { return static_cast<size_t>(zkey.w[0]); }
+    const Zobrist::Key& key() const { return zkey; }
+
+    // Collision test – one AND per row spanned by the precomputed masks
+    bool collides(int px, int py, int p, int r) const {
+        if (px < Masks::COL_MIN || px >= W) return true;
+        const typename Masks::Shape& s = Masks::TABLE[p][r];
+        const int c = px - Masks::COL_MIN;
+        if (!s.fits[c]) return true;
+
+        const int y0 = py + s.top;
+        if (y0 + s.height > H) return true;
+        for (int i = 0; i < s.height; ++i)
+            if (y0 + i >= 0 && (data[y0 + i] & s.rows[c][i])) return true;
         return false;
     }
 
-    // Place piece (sets bits)
+    // Guideline spawn row: the piece's lowest cells just above the visible field
+    // (rows 21-22 counted from the floor), or the top row without a buffer zone
+    static constexpr int spawn_top(int p) { return std::max(BUFFER - Masks::TABLE[p][0].height, 0); }
+    static constexpr int spawn_row(int p) { return spawn_top(p) - Masks::TABLE[p][0].top; }
+
+    // Block out: the spawn position of `p` is already occupied
+    bool blocked_out(int p) const { return collides(Srs::spawn_col<W>(p), spawn_row(p), p, 0); }
+
+    // Lock out: a piece resting at row py lies entirely above the visible field
+    static bool locked_out(int py, int p, int r) {
+        const typename Masks::Shape& s = Masks::TABLE[p][r];
+        return py + s.top + s.height <= BUFFER;
+    }
+
+    // Place piece (ORs the row masks; cells above the board are dropped)
     void place(int px, int py, int p, int r) {
-        for (auto [dx, dy] : PIECES[p][r]) {
-            int x = px + dx;
-            int y = py + dy;
-            if (y >= 0) data[y] |= (1 << x);
+        const typename Masks::Shape& s = Masks::TABLE[p][r];
+        const int c = px - Masks::COL_MIN;
+        const int y0 = py + s.top;
+        for (int i = 0; i < s.height; ++i) {
+            if (y0 + i < 0) continue;
+            data[y0 + i] |= s.rows[c][i];
+            zkey ^= Keys::row_key(y0 + i, s.rows[c][i]);
+            cells += Bits::popcount(static_cast<uint32_t>(s.rows[c][i]));
+        }
+
+        // Only the covered columns and their neighbours change their feature terms
+        const int x0 = px + s.left, x1 = x0 + s.width - 1;
+        const int lo = std::max(x0 - 1, 0), hi = std::min(x1 + 1, W - 1);
+        if constexpr (Config::INCREMENTAL_FEATURES) column_terms(lo, hi, -1);
+
+        for (int i = 0; i < s.width; ++i) {
+            if (py + s.bottom[i] < 0) continue;
+            uint8_t& h = heights[px + s.left + i];
+            const int top = std::max<int>(h, H - std::max(py + s.col_top[i], 0));
+            if constexpr (Config::INCREMENTAL_FEATURES) {
+                feats.height_sum += top - h;
+                feats.max_h = std::max(feats.max_h, top);
+            }
+            h = static_cast<uint8_t>(top);
+        }
+
+        if constexpr (Config::INCREMENTAL_FEATURES) {
+            column_terms(lo, hi, 1);
+            feats.holes = feats.height_sum - cells;
+        }
+
+        if constexpr (Config::TRACK_COLUMNS) {
+            for (auto [dx, dy] : PIECES[p][r])
+                if (py + dy >= 0) columns[px + dx] |= Column{1} << (H - 1 - py - dy);
         }
     }
 
-    // Line clearing with in-place compaction
-    int clear_lines() {
+    // Everything unmake() needs to take a placement back. Only the piece's own
+    // columns change unless rows clear, so only their old heights are kept.
+    struct Undo {
+        Zobrist::Key key;                          // Board key before the placement
+        RowSet cleared = 0;                        // Removed rows, bit y = row y
         int lines = 0;
-        int dst = Config::H - 1;
-        for (int src = Config::H - 1; src >= 0; --src) {
-            if (data[src] == (1 << Config::W) - 1) { ++lines; }
-            else { if (src != dst) data[dst] = data[src]; --dst; }
+        int cells = 0;
+        int max_h = 0;                             // Feature max_h before the placement
+        std::array<uint8_t, 4> heights{};          // Old heights of the piece's columns
+        int8_t px = 0, py = 0, piece = 0, rot = 0;
+    };
+
+    // Line clearing with in-place compaction
+    int clear_lines() { return Bits::popcount(remove_full_rows(0, H - 1)); }
+
+    // place() + clear_lines(), checking only the rows the piece touched
+    int place_and_clear(int px, int py, int p, int r) {
+        place(px, py, p, r);
+        const auto [lo, hi] = touched_rows(py, p, r);
+        return Bits::popcount(remove_full_rows(lo, hi));
+    }
+
+    // place() + clear_lines(), recording how to undo both
+    Undo make(int px, int py, int p, int r) {
+        Undo u;
+        u.key = zkey;
+        u.cells = cells;
+        u.max_h = feats.max_h;
+        const typename Masks::Shape& s = Masks::TABLE[p][r];
+        for (int i = 0; i < s.width; ++i) u.heights[i] = heights[px + s.left + i];
+        u.px = static_cast<int8_t>(px); u.py = static_cast<int8_t>(py);
+        u.piece = static_cast<int8_t>(p); u.rot = static_cast<int8_t>(r);
+        place(px, py, p, r);
+        const auto [lo, hi] = touched_rows(py, p, r);
+        u.cleared = remove_full_rows(lo, hi);
+        u.lines = Bits::popcount(u.cleared);
+        return u;
+    }
+
+    // Restores the board to its state before the make() that returned `u`
+    void unmake(const Undo& u) {
+        if (u.cleared) {
+            // Row y had moved down past the cleared rows below it; take it back up
+            int below = u.lines;
+            for (int y = 0; y < H; ++y) {
+                if (u.cleared & (RowSet{1} << y)) { --below; data[y] = (1 << W) - 1; }
+                else data[y] = data[y + below];
+            }
+        }
+
+        const typename Masks::Shape& s = Masks::TABLE[u.piece][u.rot];
+        const int c = u.px - Masks::COL_MIN;
+        const int y0 = u.py + s.top;
+        for (int i = 0; i < s.height; ++i)
+            if (y0 + i >= 0) data[y0 + i] &= ~s.rows[c][i];
+
+        if constexpr (Config::TRACK_COLUMNS) {
+            // Put the cleared rows back as full bits, lowest row (highest y) first so
+            // the higher indices stay valid, then take the piece's cells out
+            for (RowSet rows = u.cleared; rows; ) {
+                const int y = Bits::bit_length(rows) - 1;
+                rows &= ~(RowSet{1} << y);
+                const int b = H - 1 - y;
+                const Column below = (Column{1} << b) - 1;
+                for (Column& col : columns) col = (col & below) | ((col << 1) & ~below) | (Column{1} << b);
+            }
+            for (auto [dx, dy] : PIECES[u.piece][u.rot])
+                if (u.py + dy >= 0) columns[u.px + dx] &= ~(Column{1} << (H - 1 - u.py - dy));
+        }
+        zkey = u.key;
+        cells = u.cells;
+
+        if (u.cleared) {
+            recompute_heights();
+            if constexpr (Config::INCREMENTAL_FEATURES) recompute_features();
+            return;
+        }
+
+        // No clear: run place()'s feature delta backwards over the piece's columns
+        const int x0 = u.px + s.left, x1 = x0 + s.width - 1;
+        const int lo = std::max(x0 - 1, 0), hi = std::min(x1 + 1, W - 1);
+        if constexpr (Config::INCREMENTAL_FEATURES) column_terms(lo, hi, -1);
+        for (int i = 0; i < s.width; ++i) {
+            if constexpr (Config::INCREMENTAL_FEATURES) feats.height_sum += u.heights[i] - heights[x0 + i];
+            heights[x0 + i] = u.heights[i];
+        }
+        if constexpr (Config::INCREMENTAL_FEATURES) {
+            column_terms(lo, hi, 1);
+            feats.max_h = u.max_h;
+            feats.holes = feats.height_sum - cells;
         }
-        for (int i = dst; i >= 0; --i) data[i] = 0;
-        return lines;
     }
 
-    const std::array<int, Config::H>& raw() const { return data; }
+    // Resting positions of `p` reachable from spawn by shifts, soft drops and SRS
+    // turns, per rotation. Each rotation is flood-filled over the whole board: one
+    // top-down pass (pieces never move up) where a row inherits the row above and
+    // spreads sideways with two occluded fills. Kicks then seed the other
+    // rotations, and the passes repeat until nothing new is reached. Rows above
+    // *top (when given) hold no positions, which spares callers the buffer zone.
+    std::array<PositionMask, 4> reachable(int p, int* top = nullptr) const {
+        constexpr uint32_t ANCHORS = (1u << Masks::COLS) - 1;
+        constexpr int PAD = -Masks::COL_MIN;
+
+        // Rows as anchor-column words with the walls set: bit x + PAD = column x.
+        // Above the stack only the walls matter, and only the last shape's height
+        // of empty rows is ever read.
+        int surface = 0;
+        while (surface < H && !data[surface]) ++surface;
+        std::array<uint32_t, H> walled;
+        for (int y = std::max(surface - 3, 0); y < H; ++y)
+            walled[y] = static_cast<uint32_t>(data[y]) << PAD | ((1u << PAD) - 1) | ~0u << (W + PAD);
+
+        std::array<PositionMask, 4> open{}, seen{}, seeds{};
+        for (int r = 0; r < 4; ++r) {
+            const typename Masks::Shape& s = Masks::TABLE[p][r];
+            int t = 0;
+            for (; t + s.height <= std::min(surface, H); ++t) open[r][t] = s.fit_mask;
+            for (; t + s.height <= H; ++t) {
+                uint32_t hit = 0;
+                for (auto [dx, dy] : PIECES[p][r]) hit |= walled[t + dy - s.top] >> dx;
+                open[r][t] = ~hit & ANCHORS;
+            }
+        }
+
+        const int spawn_t = spawn_top(p);
+        const uint32_t spawn = 1u << (Srs::spawn_col<W>(p) + PAD);
+        if (top) *top = H;
+        if (!(open[0][spawn_t] & spawn)) return {};
+        seeds[0][spawn_t] = spawn;
+        int first_row = spawn_t;                   // Nothing is reached above the highest seed
+
+        // Per rotation, one bit per row holding seeds
+        std::array<RowSet, 4> seeded{RowSet{1} << spawn_t, 0, 0, 0};
+        constexpr RowSet ALL_ROWS = ~RowSet{0} >> (8 * sizeof(RowSet) - H);
+
+        // Sweep whichever rotation has seeds, then kick what it newly reached into its
+        // neighbours, until no rotation gains anything
+        for (int r = 0; seeded[0] | seeded[1] | seeded[2] | seeded[3]; r = (r + 1) % 4) {
+            if (!seeded[r]) continue;
+
+            // Rows above the first seed are already closed; past the last seed the
+            // pass stops at the first row that gains nothing
+            PositionMask fresh{};
+            RowSet fresh_rows = 0;
+            const int last_seed = Bits::bit_length(seeded[r]) - 1;
+            first_row = std::min(first_row, Bits::trailing_zeros(seeded[r]));
+            uint32_t above = 0;
+            for (int t = Bits::trailing_zeros(seeded[r]); t < H; ++t) {
+                uint32_t row = seen[r][t] | seeds[r][t] | (above & open[r][t]);
+                row = Bits::fill_up(row, open[r][t]) | Bits::fill_down(row, open[r][t]);
+                fresh[t] = row & ~seen[r][t];
+                seen[r][t] = above = row;
+                seeds[r][t] = 0;
+                if (fresh[t]) fresh_rows |= RowSet{1} << t;
+                else if (t >= last_seed) break;
+            }
+            seeded[r] = 0;
+
+            // A position takes the first kick test that fits
+            for (const Srs::Turn& turn : Srs::TURNS[p][r]) {
+                PositionMask left = fresh;
+                RowSet todo = fresh_rows;          // Rows with positions still to kick
+                for (int k = 0; k < turn.tests && todo; ++k) {
+                    const Srs::Kick& kick = turn.kicks[k];
+                    const RowSet rows = todo & Bits::shift(ALL_ROWS, -kick.dt) & ALL_ROWS;
+                    for (RowSet bits = rows; bits; bits &= bits - 1) {
+                        const int t = Bits::trailing_zeros(bits), t2 = t + kick.dt;
+                        const uint32_t moved = Bits::shift(left[t], kick.dc) & open[turn.to][t2];
+                        if (!moved) continue;
+                        left[t] &= ~Bits::shift(moved, -kick.dc);
+                        if (!left[t]) todo &= ~(RowSet{1} << t);
+                        const uint32_t gained = moved & ~seen[turn.to][t2];
+                        if (!gained) continue;
+                        seeds[turn.to][t2] |= gained;
+                        seeded[turn.to] |= RowSet{1} << t2;
+                    }
+                }
+            }
+        }
+
+        // A position rests where the row below is closed
+        for (int r = 0; r < 4; ++r)
+            for (int t = first_row; t < H; ++t)
+                seen[r][t] &= t + 1 < H ? ~open[r][t + 1] : ~0u;
+        if (top) *top = first_row;
+        return seen;
+    }
+
+    PositionMask reachable(int p, int r) const { return reachable(p)[r]; }
+
+    const std::array<Row, H>& raw() const { return data; }
+
+    PackedBoard packed() const {
+        PackedBoard p;
+        for (int y = 0; y < H; ++y) {
+            const int bit = y * W, i = bit >> 6, b = bit & 63;
+            p.w[i] |= static_cast<uint64_t>(data[y]) << b;
+            if (b + W > 64) p.w[i + 1] |= static_cast<uint64_t>(data[y]) >> (64 - b);
+        }
+        return p;
+    }
+    const std::array<uint8_t, W>& skyline() const { return heights; }
+    const BoardFeatures& features() const { return feats; }   // Requires INCREMENTAL_FEATURES
+    const std::array<Column, W>& column_bits() const { return columns; }
+
+    // Empty cells below the top of column x (only meaningful with TRACK_COLUMNS)
+    int column_holes(int x) const { return heights[x] - Bits::popcount(columns[x]); }
 };
 
+using BoardState = BasicBoardState<Config::W, Config::H>;
+
+// Board sizes the engine is built for: a plain 20-row field, the guideline
+// matrix with its 20-row buffer zone, and a narrow well
+using Board10x20 = BasicBoardState<10, 20>;
+using Board10x40 = BasicBoardState<10, 40>;
+using Board4x20  = BasicBoardState<4, 20>;
+
+// =============================================================================
+// Move generation – the reachable resting positions as a flat list
+// =============================================================================
+namespace Movegen {
+    struct Landing { int rot, col, row; };
+
+    // A position rests on the bottom of a run of open rows, so a column holds at most (H+1)/2
+    template <class Board = BoardState>
+    struct MoveList {
+        int count = 0;
+        std::array<Landing, 4 * Board::Masks::COLS * ((Board::HEIGHT + 1) / 2)> list{};
+    };
+
+    // All resting positions of `piece`, one per distinct cell set, in (rotation,
+    // row, column) order. Empty if the spawn position is blocked (block out).
+    // Positions entirely inside the buffer zone end the game (lock out), so they
+    // are left out.
+    template <class Board>
+    void generate(const Board& board, int piece, MoveList<Board>& out) {
+        using Masks = typename Board::Masks;
+        using PositionMask = typename Board::PositionMask;
+        constexpr int H = Board::HEIGHT;
+
+        out.count = 0;
+        int reached = 0;
+        const std::array<PositionMask, 4> reach = board.reachable(piece, &reached);
+
+        // Duplicate rotations fold onto their canonical one (same rows, shifted columns)
+        std::array<PositionMask, 4> rest{};
+        for (int r = 0; r < 4; ++r) {
+            const typename Masks::Canonical& canon = Masks::CANONICAL[piece][r];
+            for (int t = reached; t < H; ++t) rest[canon.rot][t] |= Bits::shift(reach[r][t], canon.dx);
+        }
+
+        for (int r = 0; r < 4; ++r) {
+            const int top = Masks::TABLE[piece][r].top;
+            int first = std::max(reached, 0);
+            while (first < H && Board::locked_out(first - top, piece, r)) ++first;
+            for (int t = first; t < H; ++t) {
+                for (uint32_t bits = rest[r][t]; bits; bits &= bits - 1) {
+                    out.list[out.count++] = {r, Bits::trailing_zeros(bits) + Masks::COL_MIN, t - top};
+                }
+            }
+        }
+    }
+}
+
 // =============================================================================
 // Heuristic evaluation (polymorphic interface for future extensions)
 // =============================================================================
-class AbstractHeuristic {
-public:
-    virtual double evaluate(const BoardState&, int lines_cleared) const = 0;
-    virtual ~AbstractHeuristic() = default;
+// Up to LANES boards scored together: the boards themselves plus their rows
+// transposed (rows[y][i] = row y of board i) for SIMD kernels. The boards must
+// outlive the batch.
+template <class Board>
+struct BasicBoardBatch {
+    static constexpr int LANES = 16;
+
+    int count = 0;
+    std::array<const Board*, LANES> boards{};
+    std::array<int, LANES> lines{};
+    alignas(32) std::array<std::array<uint16_t, LANES>, Board::HEIGHT> rows{};
+
+    // Only the AVX2 batch kernel reads `rows`: always without incremental features,
+    // otherwise just for the debug cross-check
+#if defined(__AVX2__)
+    static constexpr bool TRANSPOSE = !Config::INCREMENTAL_FEATURES || Config::CHECK_FEATURES;
+#else
+    static constexpr bool TRANSPOSE = false;
+#endif
+
+    bool full() const { return count == LANES; }
+
+    void add(const Board& b, int lines_cleared) {
+        boards[count] = &b;
+        lines[count] = lines_cleared;
+        if constexpr (TRANSPOSE)
+            for (int y = 0; y < Board::HEIGHT; ++y) rows[y][count] = b.raw()[y];
+        ++count;
+    }
 };
 
-class TetrisHeuristic final : public AbstractHeuristic {
-    const Config::Weights w;
+using BoardBatch = BasicBoardBatch<BoardState>;
 
+template <class B>
+class BasicAbstractHeuristic {
 public:
-    explicit TetrisHeuristic(Config::Weights weights = Config::HEURISTIC_WEIGHTS)
-        : w(weights) {}
+    using Board = B;
+    using Batch = BasicBoardBatch<Board>;
 
-    double evaluate(const BoardState& b, int lines_cleared) const override {
-        const auto& rows = b.raw();
-        std::array<int, Config::W> col_height{};
-        int holes = 0, bumpiness = 0, height_sum = 0, max_h = 0, wells = 0;
+    virtual double evaluate(const Board&, int lines_cleared) const = 0;
+
+    // Scores every board of the batch into out[0..count); one virtual call per batch
+    virtual void evaluate_batch(const Batch& batch, std::array<double, Batch::LANES>& out) const {
+        for (int i = 0; i < batch.count; ++i) out[i] = evaluate(*batch.boards[i], batch.lines[i]);
+    }
+
+    virtual ~BasicAbstractHeuristic() = default;
+};
+
+using AbstractHeuristic = BasicAbstractHeuristic<BoardState>;
+
+// Weights come from a policy (see Config): with a constexpr one the score folds
+// to immediate constants once the engine is instantiated on this type.
+template <class WeightPolicy, class Board = BoardState>
+class BasicTetrisHeuristic final : public BasicAbstractHeuristic<Board> {
+    static constexpr int W = Board::WIDTH, H = Board::HEIGHT;
+    using Batch = BasicBoardBatch<Board>;
+
+    const WeightPolicy weights;
+
+    using Features = BoardFeatures;
+
+    static Features scalar_features(const Board& b) {
+        std::array<int, W> col_height{};
+        Features f;
 
         // Compute column heights and count holes
-        for (int x = 0; x < Config::W; ++x) {
-            bool found = false;
-            for (int y = 0; y < Config::H; ++y) {
-                if (rows[y] & (1 << x)) {
-                    if (!found) { col_height[x] = Config::H - y; found = true; }
-                } else if (found) ++holes;
-            }
-            height_sum += col_height[x];
-            max_h = std::max(max_h, col_height[x]);
+        for (int x = 0; x < W; ++x) {
+            col_height[x] = b.skyline()[x];
+            f.height_sum += col_height[x];
+            f.max_h = std::max(f.max_h, col_height[x]);
+        }
+        if constexpr (Config::TRACK_COLUMNS) {
+            for (int x = 0; x < W; ++x) f.holes += b.column_holes(x);
+        } else {
+            f.holes = b.packed().holes().count();
         }
 
         // Bumpiness & wells
-        for (int x = 0; x < Config::W; ++x) {
-            if (x < Config::W-1) bumpiness += std::abs(col_height[x] - col_height[x+1]);
+        for (int x = 0; x < W; ++x) {
+            if (x < W-1) f.bumpiness += std::abs(col_height[x] - col_height[x+1]);
 
-            int left  = (x == 0)        ? Config::H : col_height[x-1];
-            int right = (x == Config::W-1) ? Config::H : col_height[x+1];
+            int left  = (x == 0)   ? H : col_height[x-1];
+            int right = (x == W-1) ? H : col_height[x+1];
             if (col_height[x] < left && col_height[x] < right)
-                wells += std::min(left, right) - col_height[x];
+                f.wells += std::min(left, right) - col_height[x];
+        }
+        return f;
+    }
+
+#if defined(__AVX2__)
+    // One 16-bit lane per column. Heights count the rows at or below each
+    // column's top (a running OR down the rows); holes are the empty cells under
+    // that OR. Neighbours come from reloading the stored heights one lane over.
+    static Features simd_features(const Board& b) {
+        static_assert(W <= 16, "One 16-bit lane per column");
+        const auto& rows = b.raw();
+        const __m256i lane_bit = _mm256_setr_epi16(1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024, 2048,
+                                                   4096, 8192, 16384, static_cast<short>(0x8000));
+        const __m256i lane = _mm256_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+        Features f;
+
+        __m256i height = _mm256_setzero_si256();
+        uint32_t covered = 0;
+        int y = 0;
+        while (y < H && !rows[y]) ++y;
+        for (; y < H; ++y) {
+            f.holes += Bits::popcount(covered & ~static_cast<uint32_t>(rows[y]));
+            covered |= rows[y];
+            const __m256i bits = _mm256_and_si256(_mm256_set1_epi16(static_cast<short>(covered)), lane_bit);
+            height = _mm256_sub_epi16(height, _mm256_cmpeq_epi16(bits, lane_bit));
+        }
+
+        // Heights with the walls (height H) on either side
+        alignas(32) std::array<int16_t, 48> padded{};
+        _mm256_store_si256(reinterpret_cast<__m256i*>(&padded[16]), height);
+        padded[15] = padded[16 + W] = H;
+        const __m256i left  = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&padded[15]));
+        const __m256i right = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&padded[17]));
+
+        const __m256i columns = _mm256_cmpgt_epi16(_mm256_set1_epi16(W), lane);
+        const __m256i pairs   = _mm256_cmpgt_epi16(_mm256_set1_epi16(W - 1), lane);
+        const __m256i bump = _mm256_and_si256(_mm256_abs_epi16(_mm256_sub_epi16(height, right)), pairs);
+        const __m256i is_well = _mm256_and_si256(columns, _mm256_and_si256(
+            _mm256_cmpgt_epi16(left, height), _mm256_cmpgt_epi16(right, height)));
+        const __m256i depth = _mm256_and_si256(
+            _mm256_sub_epi16(_mm256_min_epi16(left, right), height), is_well);
+
+        f.height_sum = sum_lanes(height);
+        f.bumpiness  = sum_lanes(bump);
+        f.wells      = sum_lanes(depth);
+
+        __m128i top = _mm_max_epi16(_mm256_castsi256_si128(height), _mm256_extracti128_si256(height, 1));
+        top = _mm_max_epi16(top, _mm_srli_si128(top, 8));
+        top = _mm_max_epi16(top, _mm_srli_si128(top, 4));
+        top = _mm_max_epi16(top, _mm_srli_si128(top, 2));
+        f.max_h = _mm_extract_epi16(top, 0);
+        return f;
+    }
+
+    // Batch kernel: one 16-bit lane per board, features built column by column
+    static void simd_batch_features(const Batch& batch, std::array<Features, Batch::LANES>& out) {
+        const __m256i one = _mm256_set1_epi16(1);
+        const __m256i nibble = _mm256_set1_epi8(0x0F);
+        const __m256i bit_count = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                                   0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+        __m256i height[W];
+        for (__m256i& h : height) h = _mm256_setzero_si256();
+        __m256i covered = _mm256_setzero_si256(), holes = _mm256_setzero_si256();
+
+        for (int y = 0; y < H; ++y) {
+            const __m256i row = _mm256_load_si256(reinterpret_cast<const __m256i*>(batch.rows[y].data()));
+            if (_mm256_testz_si256(covered, covered) && _mm256_testz_si256(row, row)) continue;
+
+            // Holes: per-lane popcount of covered & ~row via a nibble table
+            const __m256i empty = _mm256_andnot_si256(row, covered);
+            const __m256i bytes = _mm256_add_epi8(
+                _mm256_shuffle_epi8(bit_count, _mm256_and_si256(empty, nibble)),
+                _mm256_shuffle_epi8(bit_count, _mm256_and_si256(_mm256_srli_epi16(empty, 4), nibble)));
+            holes = _mm256_add_epi16(holes, _mm256_and_si256(
+                _mm256_add_epi16(bytes, _mm256_srli_epi16(bytes, 8)), _mm256_set1_epi16(0xFF)));
+
+            covered = _mm256_or_si256(covered, row);
+            for (int x = 0; x < W; ++x)
+                height[x] = _mm256_add_epi16(height[x], _mm256_and_si256(_mm256_srli_epi16(covered, x), one));
+        }
+
+        const __m256i wall = _mm256_set1_epi16(H);
+        __m256i height_sum = _mm256_setzero_si256(), max_h = _mm256_setzero_si256();
+        __m256i bumpiness = _mm256_setzero_si256(), wells = _mm256_setzero_si256();
+        for (int x = 0; x < W; ++x) {
+            const __m256i h = height[x];
+            const __m256i left  = x == 0 ? wall : height[x - 1];
+            const __m256i right = x == W - 1 ? wall : height[x + 1];
+            height_sum = _mm256_add_epi16(height_sum, h);
+            max_h = _mm256_max_epi16(max_h, h);
+            if (x < W - 1) bumpiness = _mm256_add_epi16(bumpiness, _mm256_abs_epi16(_mm256_sub_epi16(h, right)));
+            const __m256i is_well = _mm256_and_si256(_mm256_cmpgt_epi16(left, h), _mm256_cmpgt_epi16(right, h));
+            wells = _mm256_add_epi16(wells, _mm256_and_si256(_mm256_sub_epi16(_mm256_min_epi16(left, right), h), is_well));
+        }
+
+        alignas(32) std::array<std::array<int16_t, Batch::LANES>, 5> lanes;
+        const __m256i features[5] = {height_sum, holes, bumpiness, max_h, wells};
+        for (int k = 0; k < 5; ++k) _mm256_store_si256(reinterpret_cast<__m256i*>(lanes[k].data()), features[k]);
+        for (int i = 0; i < batch.count; ++i)
+            out[i] = {lanes[0][i], lanes[1][i], lanes[2][i], lanes[3][i], lanes[4][i]};
+    }
+
+    static int sum_lanes(__m256i v) {
+        const __m256i pairs = _mm256_madd_epi16(v, _mm256_set1_epi16(1));
+        __m128i s = _mm_add_epi32(_mm256_castsi256_si128(pairs), _mm256_extracti128_si256(pairs, 1));
+        s = _mm_hadd_epi32(s, s);
+        s = _mm_hadd_epi32(s, s);
+        return _mm_cvtsi128_si32(s);
+    }
+#endif
+
+    // Checks incremental features against the from-scratch kernels when CHECK_FEATURES
+    // is on. Called unconditionally, so the kernels stay compiled in every build.
+    static bool kernels_agree(const Board& b, const Features& f) {
+        if (!Config::CHECK_FEATURES) return true;
+#if defined(__AVX2__)
+        if (!(f == simd_features(b))) return false;
+#endif
+        return f == scalar_features(b);
+    }
+
+    static bool kernels_agree(const Batch& batch, const std::array<Features, Batch::LANES>& f) {
+        if (!Config::CHECK_FEATURES) return true;
+#if defined(__AVX2__)
+        std::array<Features, Batch::LANES> simd;
+        simd_batch_features(batch, simd);
+        for (int i = 0; i < batch.count; ++i)
+            if (!(f[i] == simd[i])) return false;
+#endif
+        for (int i = 0; i < batch.count; ++i)
+            if (!kernels_agree(*batch.boards[i], f[i])) return false;
+        return true;
+    }
+
+public:
+    explicit BasicTetrisHeuristic(WeightPolicy policy = {})
+        : weights(policy) {}
+
+    // Same integer features every way, so all paths score bit for bit alike
+    static Features features(const Board& b) {
+        if constexpr (Config::INCREMENTAL_FEATURES) {
+            [[maybe_unused]] const bool agree = kernels_agree(b, b.features());
+            assert(agree && "incremental features differ from the kernels");
+            return b.features();
+        } else {
+#if defined(__AVX2__)
+            return simd_features(b);
+#else
+            return scalar_features(b);
+#endif
         }
+    }
+
+    double evaluate(const Board& b, int lines_cleared) const override {
+        return score(features(b), lines_cleared);
+    }
 
-        return w.HEIGHT_SUM        * height_sum
-             + w.HOLES             * holes
-             + w.BUMPINESS         * bumpiness
-             + w.WELLS             * wells
-             + w.MAX_HEIGHT_SQUARED * max_h * max_h
+    void evaluate_batch(const Batch& batch, std::array<double, Batch::LANES>& out) const override {
+        std::array<Features, Batch::LANES> f;
+        if constexpr (Config::INCREMENTAL_FEATURES) {
+            for (int i = 0; i < batch.count; ++i) f[i] = batch.boards[i]->features();
+            [[maybe_unused]] const bool agree = kernels_agree(batch, f);
+            assert(agree && "incremental features differ from the kernels");
+        } else {
+#if defined(__AVX2__)
+            simd_batch_features(batch, f);
+#else
+            for (int i = 0; i < batch.count; ++i) f[i] = scalar_features(*batch.boards[i]);
+#endif
+        }
+        for (int i = 0; i < batch.count; ++i) out[i] = score(f[i], batch.lines[i]);
+    }
+
+    double score(const Features& f, int lines_cleared) const {
+        const auto& w = weights.get();
+        return w.HEIGHT_SUM        * f.height_sum
+             + w.HOLES             * f.holes
+             + w.BUMPINESS         * f.bumpiness
+             + w.WELLS             * f.wells
+             + w.MAX_HEIGHT_SQUARED * f.max_h * f.max_h
              + w.LINES_CLEARED     * lines_cleared;
     }
 };
 
+using TetrisHeuristic = BasicTetrisHeuristic<Config::RuntimeWeights>;
+
+// =============================================================================
+// Transposition table – fixed-size, open-addressed, one cache line per bucket.
+// Lock-free: every entry is four relaxed atomic words and the first word stores
+// the verification key XORed with the other three, so a torn write from a
+// concurrent thread simply fails validation (Hyatt's lockless hashing).
+// =============================================================================
+class TranspositionTable {
+    struct Entry {
+        std::atomic<uint64_t> lock{0};             // check ^ queue_sig ^ value ^ meta
+        std::atomic<uint64_t> queue_sig{0};        // Signature of the remaining queue
+        std::atomic<uint64_t> value{0};            // Bit pattern of the double value
+        std::atomic<uint64_t> meta{0};             // (draft + 1) | generation << 16, 0 = empty
+    };
+
+    // Slot 0 is depth-preferred, slot 1 is always-replace
+    struct alignas(64) Bucket { std::array<Entry, 2> slot; };
+
+    struct Data {                                  // Validated snapshot of one entry
+        uint64_t queue_sig, value, meta;
+        int draft() const { return static_cast<int>(meta & 0xFFFF) - 1; }
+        uint8_t generation() const { return static_cast<uint8_t>(meta >> 16); }
+    };
+
+    std::vector<Bucket> buckets;
+    uint64_t mask = 0;
+    uint8_t generation = 0;
+
+    static uint64_t check_word(const Zobrist::Key& k) { return k.w[Config::HASH_WORDS - 1]; }
+
+    Bucket& bucket(const Zobrist::Key& k, uint64_t sig) {
+        uint64_t idx = (k.w[0] ^ sig) * 0x9E3779B97F4A7C15ull;
+        return buckets[(idx >> 32) & mask];
+    }
+
+    static Data read(const Entry& e) {
+        return {e.queue_sig.load(std::memory_order_relaxed),
+                e.value.load(std::memory_order_relaxed),
+                e.meta.load(std::memory_order_relaxed)};
+    }
+
+    static void write(Entry& e, uint64_t check, const Data& d) {
+        e.lock.store(check ^ d.queue_sig ^ d.value ^ d.meta, std::memory_order_relaxed);
+        e.queue_sig.store(d.queue_sig, std::memory_order_relaxed);
+        e.value.store(d.value, std::memory_order_relaxed);
+        e.meta.store(d.meta, std::memory_order_relaxed);
+    }
+
+public:
+    explicit TranspositionTable(size_t megabytes) {
+        size_t count = 1;
+        while (count * 2 * sizeof(Bucket) <= megabytes * 1024 * 1024) count *= 2;
+        buckets = std::vector<Bucket>(count);
+        mask = count - 1;
+    }
+
+    void clear() {
+        for (Bucket& b : buckets)
+            for (Entry& e : b.slot) write(e, 0, Data{0, 0, 0});
+        generation = 0;
+    }
+
+    // Start a new search: older entries stay readable but become the first to be replaced
+    void new_search() { ++generation; }
+
+    bool probe(const Zobrist::Key& k, uint64_t sig, int draft, double& value) {
+        const uint64_t check = check_word(k);
+        for (const Entry& e : bucket(k, sig).slot) {
+            const uint64_t lock = e.lock.load(std::memory_order_relaxed);
+            const Data d = read(e);
+            if ((lock ^ d.queue_sig ^ d.value ^ d.meta) != check) continue;
+            if (d.queue_sig != sig || d.draft() != draft) continue;
+            std::memcpy(&value, &d.value, sizeof value);
+            return true;
+        }
+        return false;
+    }
+
+    void store(const Zobrist::Key& k, uint64_t sig, int draft, double value) {
+        Bucket& b = bucket(k, sig);
+        Data d{sig, 0, static_cast<uint64_t>(draft + 1) | static_cast<uint64_t>(generation) << 16};
+        std::memcpy(&d.value, &value, sizeof value);
+
+        const Data deep = read(b.slot[0]);
+        if (deep.generation() != generation || draft >= deep.draft()) write(b.slot[0], check_word(k), d);
+        else                                                          write(b.slot[1], check_word(k), d);
+    }
+};
+
+// Unique signature of queue[from, to): one octal digit per piece behind a sentinel
+inline uint64_t queue_signature(const std::vector<int>& queue, int from, int to) {
+    uint64_t sig = 1;
+    for (int i = from; i < to; ++i) sig = sig * 8 + queue[i];
+    return sig;
+}
+
+// =============================================================================
+// Work-stealing thread pool – persistent workers, one deque per thread
+// =============================================================================
+class ThreadPool {
+    struct Queue {
+        std::mutex m;
+        std::deque<int> items;
+    };
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<Queue>> queues;    // One per worker; the last belongs to the caller
+    std::atomic<const std::function<void(int)>*> job{nullptr};
+    std::atomic<int> remaining{0};
+
+    std::mutex m;
+    std::condition_variable wake, done;
+    uint64_t epoch = 0;
+    bool quit = false;
+
+    // Own work from the back, stolen work from the front of the other deques
+    bool pop(int self, int& item) {
+        const int n = static_cast<int>(queues.size());
+        for (int i = 0; i < n; ++i) {
+            Queue& q = *queues[(self + i) % n];
+            std::lock_guard<std::mutex> lk(q.m);
+            if (q.items.empty()) continue;
+            if (i == 0) { item = q.items.back();  q.items.pop_back(); }
+            else        { item = q.items.front(); q.items.pop_front(); }
+            return true;
+        }
+        return false;
+    }
+
+    void drain(int self) {
+        int item;
+        while (pop(self, item)) {
+            (*job.load())(item);
+            if (remaining.fetch_sub(1) == 1) {
+                std::lock_guard<std::mutex> lk(m);
+                done.notify_all();
+            }
+        }
+    }
+
+    void worker_loop(int self) {
+        uint64_t seen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lk(m);
+                wake.wait(lk, [&] { return quit || epoch != seen; });
+                if (quit) return;
+                seen = epoch;
+            }
+            drain(self);
+        }
+    }
+
+public:
+    explicit ThreadPool(int threads) {
+        for (int i = 0; i < std::max(threads, 1); ++i) queues.push_back(std::make_unique<Queue>());
+        for (int i = 0; i + 1 < size(); ++i) workers.emplace_back([this, i] { worker_loop(i); });
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lk(m);
+            quit = true;
+        }
+        wake.notify_all();
+        for (std::thread& t : workers) t.join();
+    }
+
+    int size() const { return static_cast<int>(queues.size()); }
+
+    // Runs task(i) for every i in [0, count) on the workers and the calling thread.
+    // Returns once all tasks are done. Not reentrant: tasks must not call it.
+    void parallel_for(int count, const std::function<void(int)>& task) {
+        if (count <= 0) return;
+        job = &task;
+        remaining = count;
+        for (int i = 0; i < count; ++i) {
+            Queue& q = *queues[i % size()];
+            std::lock_guard<std::mutex> lk(q.m);
+            q.items.push_back(i);
+        }
+        {
+            std::lock_guard<std::mutex> lk(m);
+            ++epoch;
+        }
+        wake.notify_all();
+
+        drain(size() - 1);
+        std::unique_lock<std::mutex> lk(m);
+        done.wait(lk, [&] { return remaining.load() == 0; });
+    }
+};
+
 // =============================================================================
-// AI Engine – depth-limited minimax with transposition table
+// Search engine interface
 // =============================================================================
-class AIEngine {
-    const AbstractHeuristic& heuristic;
-    mutable std::map<size_t, double> transposition;
+template <class Board>
+class BasicAbstractEngine {
+public:
+    virtual Move find_best_move(Board board, const std::vector<int>& queue,
+                                const SearchOptions& opts = {}) = 0;
+    virtual ~BasicAbstractEngine() = default;
+};
 
-    double lookahead(const BoardState& board, const std::vector<int>& queue, int depth) const {
-        if (depth >= static_cast<int>(queue.size())) return 0.0;
+using AbstractEngine = BasicAbstractEngine<BoardState>;
 
-        size_t h = board.hash();
-        if (transposition.count(h)) return transposition.at(h);
+// =============================================================================
+// AI Engine – depth-limited expectimax with transposition table: max nodes for
+// the preview pieces, then chance nodes that average the best placement over
+// the (sampled) possible next pieces. Searched by iterative deepening so a
+// deadline always leaves a completed iteration to fall back on. Two parallel
+// modes: Lazy SMP (helpers search the same root in a rotated move order and
+// only feed the shared table) and root splitting (placements are farmed out to
+// a work-stealing pool and reduced in canonical order). Both return the same
+// move as a single-threaded search.
+// Templated on the heuristic: a concrete (final) one is called directly and
+// inlined into the move loops; AIEngine<> goes through the virtual interface
+// for heuristics only known at run time.
+// =============================================================================
+template <class Heuristic = AbstractHeuristic>
+class AIEngine final : public BasicAbstractEngine<typename Heuristic::Board> {
+    using Board = typename Heuristic::Board;
+    using Batch = BasicBoardBatch<Board>;
+    static constexpr bool DYNAMIC = std::is_abstract_v<Heuristic>;
+
+    const Heuristic& heuristic;
+    mutable TranspositionTable transposition;
+    std::unique_ptr<ThreadPool> pool;
+
+    Clock::time_point deadline = Clock::time_point::max();
+    mutable std::atomic<bool> halted{false};   // Deadline passed: the iteration is void
+
+    BagState preview_bag;                      // Bag contents once the preview is used up
+    int chance_samples = Config::PIECE_COUNT;
+    uint64_t chance_sig = 0;                   // Folds the chance settings into table keys
+    bool use_hold = false;
+
+    static constexpr int CANDIDATES = 4 * Board::Masks::COLS;   // Spread of the helpers' move-order offsets
+
+    struct ThreadContext {
+        int horizon = 0;                           // Plies searched by this iteration
+        int order = 0;                             // Offset into the candidate order, 0 = canonical
+        const std::atomic<bool>* done = nullptr;   // Lazy SMP: raised once the main thread is done
+        unsigned polls = Config::DEADLINE_POLL_NODES - 1;   // First poll reads the clock
+    };
 
+    // Search state besides the board
+    struct NodeState {
+        int ply = 0;                               // Placements made since the root
+        int next = 0;                              // Index of the next preview piece
+        int hold = -1;                             // Held piece, -1 = empty
+        BagState bag;                              // Bag for the draws past the preview
+    };
+
+    // One way to spend the current piece: place it, or swap it into the hold slot
+    struct Option {
+        int piece;                                 // Piece that gets placed
+        NodeState child;                           // State after the placement
+        bool hold;
+    };
+
+    bool aborted(ThreadContext& ctx) const {
+        if (halted.load(std::memory_order_relaxed)) return true;
+        if (ctx.done && ctx.done->load(std::memory_order_relaxed)) return true;
+        if (deadline != Clock::time_point::max() && ++ctx.polls % Config::DEADLINE_POLL_NODES == 0
+            && Clock::now() >= deadline) {
+            halted = true;
+            return true;
+        }
+        return false;
+    }
+
+    // Unthrottled clock check for serial setup work outside the node search
+    bool expired() const {
+        if (deadline != Clock::time_point::max() && Clock::now() >= deadline) halted = true;
+        return halted.load(std::memory_order_relaxed);
+    }
+
+    // Options for `current` once it has been taken (state `after`). Swapping with an
+    // identical held piece would repeat the plain placement, so it is skipped. An
+    // empty hold slot pulls the following preview piece, never a chance draw. A
+    // blocked-out `current` ends the game before hold can be used: no options.
+    int options(const Board& board, const std::vector<int>& queue, int current, NodeState after,
+                std::array<Option, 2>& out) const {
+        if (board.blocked_out(current)) return 0;
+        ++after.ply;
+        out[0] = {current, after, false};
+        if (!use_hold || after.hold == current) return 1;
+
+        NodeState swapped = after;
+        swapped.hold = current;
+        if (after.hold >= 0) {
+            out[1] = {after.hold, swapped, true};
+            return 2;
+        }
+        if (after.next < static_cast<int>(queue.size())) {
+            ++swapped.next;
+            out[1] = {queue[after.next], swapped, true};
+            return 2;
+        }
+        return 1;
+    }
+
+    // Everything besides the board that a node's value depends on: the hold slot, the
+    // preview pieces the remaining plies can reach and, once those may run out, the
+    // bag and chance settings
+    uint64_t node_signature(const std::vector<int>& queue, const NodeState& st, int horizon) const {
+        const int size = static_cast<int>(queue.size());
+        const int reach = st.next + (horizon - st.ply) + (use_hold && st.hold < 0 ? 1 : 0);
+        const int known = std::min(reach, size);
+        uint64_t sig = queue_signature(queue, std::min(st.next, known), known);
+        if (reach > size) sig ^= chance_sig ^ (st.bag.key() + 1) * 0x9E3779B97F4A7C15ull;
+        if (use_hold) sig ^= static_cast<uint64_t>(st.hold + 2) * 0xC2B2AE3D27D4EB4Full;
+        return sig;
+    }
+
+    // Last ply: the children are only evaluated. A virtual heuristic scores them
+    // in batches to amortize the call; a concrete one inline on the mutable board.
+    double best_leaf(Board& board, int piece, const Movegen::MoveList<Board>& moves) const {
         double best = -1e12;
-        bool valid_move = false;
-        int piece = queue[depth];
+        if constexpr (!DYNAMIC) {
+            for (int i = 0; i < moves.count; ++i) {
+                const auto [r, c, y] = moves.list[i];
+                const typename Board::Undo undo = board.make(c, y, piece, r);
+                best = std::max(best, heuristic.evaluate(board, undo.lines));
+                board.unmake(undo);
+            }
+            return best;
+        }
 
-        for (int r = 0; r < 4; ++r) {
-            for (int c = -3; c < Config::W; ++c) {
-                BoardState sim = board;
-                int y = 0;
-                if (sim.collides(c, y, piece, r)) continue;
-                while (!sim.collides(c, y+1, piece, r)) ++y;
-
-                sim.place(c, y, piece, r);
-                int lines = sim.clear_lines();
-                double score = heuristic.evaluate(sim, lines)
-                             + lookahead(sim, queue, depth + 1);
-
-                best = std::max(best, score);
-                valid_move = true;
+        std::array<Board, Batch::LANES> children;
+        std::array<double, Batch::LANES> scores;
+        Batch batch;
+        for (int i = 0; i < moves.count; ++i) {
+            const auto [r, c, y] = moves.list[i];
+            Board& sim = children[batch.count];
+            sim = board;
+            batch.add(sim, sim.place_and_clear(c, y, piece, r));
+            if (!batch.full() && i + 1 < moves.count) continue;
+
+            heuristic.evaluate_batch(batch, scores);
+            for (int k = 0; k < batch.count; ++k) best = std::max(best, scores[k]);
+            batch.count = 0;
+        }
+        return best;
+    }
+
+    // Best placement of `piece` plus the value of the plies below it
+    double best_placement(Board& board, const std::vector<int>& queue, int piece,
+                          const NodeState& child, ThreadContext& ctx) const {
+        double best = -1e12;
+        Movegen::MoveList<Board> moves;
+        Movegen::generate(board, piece, moves);
+        if (child.ply >= ctx.horizon) return best_leaf(board, piece, moves);
+
+        for (int i = 0; i < moves.count; ++i) {
+            const auto [r, c, y] = moves.list[(i + ctx.order) % moves.count];
+            const typename Board::Undo undo = board.make(c, y, piece, r);
+            double score = heuristic.evaluate(board, undo.lines)
+                         + lookahead(board, queue, child, ctx);
+            board.unmake(undo);
+
+            best = std::max(best, score);
+        }
+        return best;
+    }
+
+    // Max node: the best option for `current` (a top-out if it is blocked out)
+    double max_node(Board& board, const std::vector<int>& queue, int current,
+                    const NodeState& after, ThreadContext& ctx) const {
+        std::array<Option, 2> choices;
+        const int n = options(board, queue, current, after, choices);
+        double best = -1e12;
+        for (int i = 0; i < n; ++i)
+            best = std::max(best, best_placement(board, queue, choices[i].piece, choices[i].child, ctx));
+        return best;
+    }
+
+    // Chance node: mean over the pieces still in the bag. When more are possible than
+    // `chance_samples`, a subset is drawn with a board-seeded shuffle so the same node
+    // always averages the same pieces (and caches consistently).
+    double chance_node(Board& board, const std::vector<int>& queue,
+                       const NodeState& st, ThreadContext& ctx) const {
+        std::array<int, Config::PIECE_COUNT> pieces{};
+        int count = 0;
+        for (int p = 0; p < Config::PIECE_COUNT; ++p)
+            if (st.bag.contains(p)) pieces[count++] = p;
+
+        if (count > chance_samples) {
+            uint64_t seed = board.hash() ^ st.bag.key();   // Only what the table key covers
+            for (int i = 0; i < chance_samples; ++i) {
+                int j = i + static_cast<int>(Zobrist::splitmix64(seed) % (count - i));
+                std::swap(pieces[i], pieces[j]);
             }
+            count = chance_samples;
+        }
+
+        double sum = 0.0;
+        for (int i = 0; i < count; ++i) {
+            NodeState after = st;
+            after.bag = st.bag.after(pieces[i]);
+            sum += max_node(board, queue, pieces[i], after, ctx);
         }
+        return sum / count;
+    }
+
+    double lookahead(Board& board, const std::vector<int>& queue,
+                     const NodeState& st, ThreadContext& ctx) const {
+        if (st.ply >= ctx.horizon) return 0.0;
+        if (aborted(ctx)) return 0.0;
+
+        const uint64_t sig = node_signature(queue, st, ctx.horizon);
+        const int draft = ctx.horizon - st.ply;
+        double cached;
+        if (transposition.probe(board.key(), sig, draft, cached)) return cached;
+
+        double value;
+        if (st.next < static_cast<int>(queue.size())) {
+            NodeState after = st;
+            ++after.next;
+            value = max_node(board, queue, queue[st.next], after, ctx);
+        } else {
+            value = chance_node(board, queue, st, ctx);
+        }
+
+        if (aborted(ctx)) return 0.0;              // Partial result – never cache it
+        transposition.store(board.key(), sig, draft, value);
+        return value;
+    }
 
-        if (!valid_move) best = -1e12;
-        transposition[h] = best;
+    // Root options in canonical order: the plain placement first, then the hold swap
+    int root_options(const Board& board, const std::vector<int>& queue, int hold,
+                     std::array<Option, 2>& out) const {
+        NodeState after;
+        after.next = 1;
+        after.hold = hold;
+        after.bag = preview_bag;
+        return options(board, queue, queue[0], after, out);
+    }
+
+    Move search_root(const Board& board, const std::vector<int>& queue, int hold,
+                     ThreadContext& ctx) const {
+        std::array<Option, 2> choices;
+        const int n = root_options(board, queue, hold, choices);
+        Move best;
+
+        Board work = board;                   // The thread's one mutable board
+        Movegen::MoveList<Board> moves;
+        for (int o = 0; o < n; ++o) {
+            Movegen::generate(work, choices[o].piece, moves);
+            for (int i = 0; i < moves.count; ++i) {
+                const auto [r, c, y] = moves.list[(i + ctx.order) % moves.count];
+                const typename Board::Undo undo = work.make(c, y, choices[o].piece, r);
+                double score = heuristic.evaluate(work, undo.lines)
+                             + lookahead(work, queue, choices[o].child, ctx);
+                work.unmake(undo);
+
+                // A forced top-out scores below -1e12 but still beats having no move
+                if (best.rot < 0 || score > best.score) best = {r, c, y, score, choices[o].hold};
+            }
+        }
         return best;
     }
 
-public:
-    explicit AIEngine(const AbstractHeuristic& h) : heuristic(h) {}
+    ThreadPool& workers(int threads) {
+        if (!pool || pool->size() != threads) pool = std::make_unique<ThreadPool>(threads);
+        return *pool;
+    }
 
-    Move find_best_move(BoardState board, const std::vector<int>& queue) {
-        transposition.clear();
+    Move search_lazy_smp(const Board& board, const std::vector<int>& queue, int hold,
+                         int horizon, int threads) {
+        std::atomic<bool> done{false};
         Move best;
-        int current = queue[0];
+        workers(threads).parallel_for(threads, [&](int t) {
+            if (t == 0) {
+                ThreadContext ctx{horizon};
+                best = search_root(board, queue, hold, ctx);
+                done = true;
+            } else {
+                ThreadContext ctx{horizon, (t * CANDIDATES) / threads, &done};
+                search_root(board, queue, hold, ctx);
+            }
+        });
+        return best;
+    }
 
-        for (int r = 0; r < 4; ++r) {
-            for (int c = -3; c < Config::W; ++c) {
-                BoardState sim = board;
-                int y = 0;
-                if (sim.collides(c, y, current, r)) continue;
-                while (!sim.collides(c, y+1, current, r)) ++y;
-
-                sim.place(c, y, current, r);
-                int lines = sim.clear_lines();
-                double score = heuristic.evaluate(sim, lines)
-                             + lookahead(sim, queue, 1);
-
-                if (score > best.score) best = {r, c, score};
+    struct Branch {
+        int r, c, y;
+        bool hold;
+        Board sim;
+        double eval;
+        NodeState state;                           // State below the placement
+    };
+
+    // Every placement of every option, in canonical order
+    void branches(const Board& board, const std::array<Option, 2>& choices, int n,
+                  std::vector<Branch>& out) const {
+        Movegen::MoveList<Board> moves;
+        for (int o = 0; o < n; ++o) {
+            Movegen::generate(board, choices[o].piece, moves);
+            for (int i = 0; i < moves.count; ++i) {
+                const auto [r, c, y] = moves.list[i];
+                Board sim = board;
+                int lines = sim.place_and_clear(c, y, choices[o].piece, r);
+                out.push_back({r, c, y, choices[o].hold, sim, heuristic.evaluate(sim, lines),
+                               choices[o].child});
             }
         }
+    }
+
+    Move search_root_split(const Board& board, const std::vector<int>& queue, int hold,
+                           int horizon, int threads, int split_depth) {
+        std::array<Option, 2> choices;
+        std::vector<Branch> roots;
+        branches(board, choices, root_options(board, queue, hold, choices), roots);
+
+        // A root is split into its children when splitting two plies deep and its next
+        // piece is known; otherwise the whole root subtree is one task
+        std::vector<std::pair<int, Branch>> tasks;
+        std::vector<bool> split(roots.size(), false);
+        for (int i = 0; i < static_cast<int>(roots.size()); ++i) {
+            const NodeState& st = roots[i].state;
+            split[i] = split_depth >= 2 && horizon >= 2 && st.next < static_cast<int>(queue.size());
+            if (!split[i]) { tasks.push_back({i, roots[i]}); continue; }
+            if (expired()) return Move{};          // Building every child takes a while
+
+            NodeState after = st;
+            ++after.next;
+            std::vector<Branch> children;
+            branches(roots[i].sim, choices, options(roots[i].sim, queue, queue[st.next], after, choices),
+                     children);
+            for (Branch& b : children) tasks.push_back({i, b});
+        }
+
+        std::vector<double> values(tasks.size());
+        workers(threads).parallel_for(static_cast<int>(tasks.size()), [&](int t) {
+            const Branch& task = tasks[t].second;
+            ThreadContext ctx{horizon};
+            Board work = task.sim;
+            values[t] = split[tasks[t].first] ? task.eval + lookahead(work, queue, task.state, ctx)
+                                              : lookahead(work, queue, task.state, ctx);
+        });
+        if (halted) return Move{};
+
+        // Deterministic reduction in task order, exactly as the sequential loops would
+        std::vector<double> root_values(roots.size(), -1e12);
+        for (size_t t = 0; t < tasks.size(); ++t) {
+            double& v = root_values[tasks[t].first];
+            v = split[tasks[t].first] ? std::max(v, values[t]) : values[t];
+        }
+
+        Move best;
+        for (size_t i = 0; i < roots.size(); ++i) {
+            if (split[i]) {
+                transposition.store(roots[i].sim.key(), node_signature(queue, roots[i].state, horizon),
+                                    horizon - 1, root_values[i]);
+            }
+            double score = roots[i].eval + root_values[i];
+            if (best.rot < 0 || score > best.score)
+                best = {roots[i].r, roots[i].c, roots[i].y, score, roots[i].hold};
+        }
+        return best;
+    }
+
+    // One full-width iteration to `horizon` plies; false if the deadline cut it short
+    bool search_iteration(const Board& board, const std::vector<int>& queue,
+                          const SearchOptions& opts, int horizon, Move& out) {
+        Move m;
+        if (opts.threads <= 1) {
+            ThreadContext ctx{horizon};
+            m = search_root(board, queue, opts.hold, ctx);
+        } else if (opts.mode == Parallelism::RootSplit) {
+            m = search_root_split(board, queue, opts.hold, horizon, opts.threads, opts.split_depth);
+        } else {
+            m = search_lazy_smp(board, queue, opts.hold, horizon, opts.threads);
+        }
+        if (halted) return false;
+        if (m.rot >= 0 || out.rot < 0) out = m;    // Never trade a legal move for none
+        return true;
+    }
+
+public:
+    explicit AIEngine(const Heuristic& h, size_t tt_megabytes = Config::TT_MEGABYTES)
+        : heuristic(h), transposition(tt_megabytes) {}
+
+    Move find_best_move(Board board, const std::vector<int>& queue,
+                        const SearchOptions& opts = {}) override {
+        transposition.new_search();
+        const int full = static_cast<int>(queue.size()) + std::max(opts.chance_depth, 0);
+
+        preview_bag = opts.bag;
+        use_hold = opts.use_hold;
+        chance_samples = std::max(opts.chance_samples, 1);
+        uint64_t seed = static_cast<uint64_t>(chance_samples);
+        chance_sig = Zobrist::splitmix64(seed);
+
+        // Without a deadline go straight to full depth. With one, deepen one ply at a
+        // time; the 1-ply iteration always runs to completion so a move is guaranteed.
+        Move best;
+        deadline = Clock::time_point::max();
+        halted = false;
+        if (opts.deadline == Clock::time_point::max()) {
+            search_iteration(board, queue, opts, full, best);
+            return best;
+        }
+
+        search_iteration(board, queue, opts, 1, best);
+        deadline = opts.deadline;
+        for (int horizon = 2; horizon <= full; ++horizon)
+            if (!search_iteration(board, queue, opts, horizon, best)) break;
         return best;
     }
 };
 
+// =============================================================================
+// Beam search – keeps only the best `width` boards per ply, so the cost per move
+// is fixed (width x placements x depth) no matter how long the preview is.
+// Plies past the preview are chance plies: every node is scored with the
+// mean over the pieces left in the bag of their best placement, and those
+// placements become its successors. A deadline drops the ply in progress and
+// answers from the last completed beam.
+// =============================================================================
+template <class Heuristic = AbstractHeuristic>
+class BeamSearchEngine final : public BasicAbstractEngine<typename Heuristic::Board> {
+    using Board = typename Heuristic::Board;
+    using Batch = BasicBoardBatch<Board>;
+    const Heuristic& heuristic;
+    const int width;
+    const int depth;
+    bool use_hold = false;
+
+    struct Node {
+        Board board;
+        double score;                              // Sum of ply values along the path
+        int root_rot, root_col, root_row;          // Placement of queue[0] that leads here
+        bool root_hold;
+        int next;                                  // Index of the next preview piece
+        int hold;                                  // Held piece, -1 = empty
+        BagState bag;                              // Bag left for the chance plies
+    };
+
+    // All reachable placements of `piece` below `parent`
+    void expand(const Node& parent, int piece, std::vector<Node>& out, bool is_root,
+                bool via_hold) const {
+        Movegen::MoveList<Board> moves;
+        Movegen::generate(parent.board, piece, moves);
+        const size_t first = out.size();
+        std::array<int, std::tuple_size<decltype(moves.list)>::value> lines;
+        for (int i = 0; i < moves.count; ++i) {
+            const auto [r, c, y] = moves.list[i];
+            Node child = parent;
+            lines[i] = child.board.place_and_clear(c, y, piece, r);
+            if (is_root) { child.root_rot = r; child.root_col = c; child.root_row = y; child.root_hold = via_hold; }
+            out.push_back(child);
+        }
+
+        std::array<double, Batch::LANES> scores;
+        for (int i = 0; i < moves.count; i += Batch::LANES) {
+            Batch batch;
+            for (int k = i; k < std::min(i + Batch::LANES, moves.count); ++k)
+                batch.add(out[first + k].board, lines[k]);
+            heuristic.evaluate_batch(batch, scores);
+            for (int k = 0; k < batch.count; ++k) out[first + i + k].score = parent.score + scores[k];
+        }
+    }
+
+    // Placements of `current` (already taken, state `after`) and of the hold swap.
+    // None if `current` is blocked out: the game ends before hold can be used.
+    void expand_options(const Node& after, int current, const std::vector<int>& queue,
+                        std::vector<Node>& out, bool is_root) const {
+        if (after.board.blocked_out(current)) return;
+        expand(after, current, out, is_root, false);
+        if (!use_hold || after.hold == current) return;
+
+        Node swapped = after;
+        swapped.hold = current;
+        if (after.hold >= 0) {
+            expand(swapped, after.hold, out, is_root, true);
+        } else if (after.next < static_cast<int>(queue.size())) {
+            ++swapped.next;
+            expand(swapped, queue[after.next], out, is_root, true);
+        }
+    }
+
+    // Chance ply: the expected best-placement value over the possible pieces
+    void expand_unseen(const Node& parent, const std::vector<int>& queue,
+                       std::vector<Node>& out) const {
+        std::vector<Node> children, best_per_piece;
+        double expected = 0.0;
+        for (int p = 0; p < Config::PIECE_COUNT; ++p) {
+            if (!parent.bag.contains(p)) continue;
+            Node after = parent;
+            after.bag = parent.bag.after(p);
+            children.clear();
+            expand_options(after, p, queue, children, false);
+            if (children.empty()) return;          // Some piece tops out: prune the node
+            auto best = std::max_element(children.begin(), children.end(),
+                [](const Node& a, const Node& b) { return a.score < b.score; });
+            expected += best->score - parent.score;
+            best_per_piece.push_back(*best);
+        }
+        expected /= best_per_piece.size();
+        for (Node& n : best_per_piece) {
+            n.score = parent.score + expected;
+            out.push_back(n);
+        }
+    }
+
+    // Keep the `width` best distinct states (stable, so ties resolve in generation order)
+    void prune(std::vector<Node>& nodes) const {
+        std::stable_sort(nodes.begin(), nodes.end(),
+            [](const Node& a, const Node& b) { return a.score > b.score; });
+        std::unordered_set<uint64_t> seen;
+        size_t kept = 0;
+        for (size_t i = 0; i < nodes.size() && kept < static_cast<size_t>(width); ++i) {
+            const Node& n = nodes[i];
+            const uint64_t key = n.board.hash() ^ static_cast<uint64_t>(n.hold + 2) * 0xC2B2AE3D27D4EB4Full
+                               ^ static_cast<uint64_t>(n.next) * 0x9E3779B97F4A7C15ull;
+            if (seen.insert(key).second) nodes[kept++] = n;
+        }
+        nodes.resize(kept);
+    }
+
+public:
+    explicit BeamSearchEngine(const Heuristic& h, int beam_width = Config::BEAM_WIDTH,
+                              int beam_depth = Config::BEAM_DEPTH)
+        : heuristic(h), width(std::max(beam_width, 1)), depth(std::max(beam_depth, 1)) {}
+
+    Move find_best_move(Board board, const std::vector<int>& queue,
+                        const SearchOptions& opts = {}) override {
+        use_hold = opts.use_hold;
+        std::vector<Node> beam, next;
+        expand_options(Node{board, 0.0, -1, -1, -1, false, 1, opts.hold, opts.bag}, queue[0], queue,
+                       beam, true);
+        prune(beam);
+
+        const bool timed = opts.deadline != Clock::time_point::max();
+        for (int ply = 1; ply < depth && !beam.empty(); ++ply) {
+            next.clear();
+            bool expired = false;
+            for (const Node& n : beam) {
+                if (timed && Clock::now() >= opts.deadline) { expired = true; break; }
+                if (n.next < static_cast<int>(queue.size())) {
+                    Node after = n;
+                    ++after.next;
+                    expand_options(after, queue[n.next], queue, next, false);
+                } else {
+                    expand_unseen(n, queue, next);
+                }
+            }
+            if (expired || next.empty()) break;    // Out of time or all lines top out: keep last beam
+            prune(next);
+            beam.swap(next);
+        }
+
+        if (beam.empty()) return Move{};
+        const Node& best = beam.front();
+        return {best.root_rot, best.root_col, best.root_row, best.score, best.root_hold};
+    }
+};
+
 // =============================================================================
 // 7-bag randomizer
 // =============================================================================
@@ -253,8 +2068,25 @@ public:
         bag.erase(bag.begin());
         return p;
     }
+
+    // What is left in the current bag, as seen by the search's chance nodes
+    BagState bag_state() const {
+        if (bag.empty()) return BagState{};
+        BagState state{0, static_cast<uint8_t>(Config::PIECE_COUNT - bag.size())};
+        for (int p : bag) state.remaining |= 1 << p;
+        return state;
+    }
 };
 
+// The sizes other than the demo's, and the engines over the virtual heuristic
+// interface, are instantiated explicitly so they stay compiled
+template class AIEngine<>;
+template class BeamSearchEngine<>;
+template class AIEngine<BasicTetrisHeuristic<Config::DefaultWeights, Board10x20>>;
+template class AIEngine<BasicTetrisHeuristic<Config::DefaultWeights, Board4x20>>;
+template class BeamSearchEngine<BasicTetrisHeuristic<Config::DefaultWeights, Board10x20>>;
+template class BeamSearchEngine<BasicTetrisHeuristic<Config::DefaultWeights, Board4x20>>;
+
 // =============================================================================
 // Rendering helpers
 // =============================================================================
@@ -264,28 +2096,32 @@ void setup_console() { _setmode(_fileno(stdout), _O_U16TEXT); }
 void setup_console() {}
 #endif
 
-std::vector<std::vector<int>> visual(const BoardState& b) {
-    std::vector<std::vector<int>> v(Config::H, std::vector<int>(Config::W, 0));
-    for (int y = 0; y < Config::H; ++y)
-        for (int x = 0; x < Config::W; ++x)
-            if (b.raw()[y] & (1 << x)) v[y][x] = 1;
+// The visible field only; the buffer zone above it stays hidden
+template <int W, int H>
+std::vector<std::vector<int>> visual(const BasicBoardState<W, H>& b) {
+    constexpr int BUFFER = BasicBoardState<W, H>::BUFFER;
+    std::vector<std::vector<int>> v(H - BUFFER, std::vector<int>(W, 0));
+    for (int y = BUFFER; y < H; ++y)
+        for (int x = 0; x < W; ++x)
+            if (b.raw()[y] & (1 << x)) v[y - BUFFER][x] = 1;
     return v;
 }
 
-void draw(const BoardState& b, int score) {
+template <int W, int H>
+void draw(const BasicBoardState<W, H>& b, int score) {
 #ifdef _WIN32
     system("cls");
 #else
     system("clear");
 #endif
     auto v = visual(b);
-    std::wcout << L"╔══════════╗\n";
+    std::wcout << L"╔" << std::wstring(W, L'═') << L"╗\n";
     for (const auto& row : v) {
         std::wcout << L"║";
         for (int cell : row) std::wcout << (cell ? L'█' : L'·');
         std::wcout << L"║\n";
     }
-    std::wcout << L"╚══════════╝\nScore: " << score << L'\n';
+    std::wcout << L"╚" << std::wstring(W, L'═') << L"╝\nScore: " << score << L'\n';
 }
 
 // =============================================================================
@@ -296,36 +2132,54 @@ int main() {
 
     BoardState board;
     PieceGenerator gen;
-    TetrisHeuristic heuristic;
+    BasicTetrisHeuristic<Config::DefaultWeights> heuristic;
     AIEngine ai(heuristic);
+    SearchOptions opts;
+    opts.threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
 
     int score = 0;
+    int hold = -1;
     std::vector<int> queue(Config::LOOKAHEAD_DEPTH);
     for (int& p : queue) p = gen.next();
 
+    const wchar_t* reason = L"";
     while (true) {
-        Move m = ai.find_best_move(board, queue);
-        if (m.score <= -1e12) break;               // No legal move → game over
+        opts.deadline = Clock::now() + std::chrono::milliseconds(Config::MOVE_BUDGET_MS);
+        opts.bag = gen.bag_state();
+        opts.hold = hold;
+        if (board.blocked_out(queue[0])) {         // Spawn occupied → game over, hold or not
+            reason = L"Block out";
+            break;
+        }
+        // The generator drops lock-out placements, so no move means every one locks out
+        Move m = ai.find_best_move(board, queue, opts);
+        if (m.rot < 0) {
+            reason = L"Lock out";
+            break;
+        }
 
+        // A hold swap plays the held piece, or with an empty slot the next one
         int piece = queue[0];
-        int drop_y = 0;
-        while (!board.collides(m.col, drop_y + 1, piece, m.rot)) ++drop_y;
-        board.place(m.col, drop_y, piece, m.rot);
-
-        int lines = board.clear_lines();
+        int used = 1;                              // Preview pieces consumed this turn
+        if (m.hold) {
+            if (hold < 0) { piece = queue[1]; used = 2; }
+            else            piece = hold;
+            hold = queue[0];
+        }
+        int lines = board.place_and_clear(m.col, m.row, piece, m.rot);
         static constexpr std::array<int,5> bonus{0,100,300,500,800};
         score += bonus[lines];
 
-        // Shift queue and fetch next piece
-        std::rotate(queue.begin(), queue.begin() + 1, queue.end());
-        queue.back() = gen.next();
+        // Shift queue and fetch next pieces
+        std::rotate(queue.begin(), queue.begin() + used, queue.end());
+        for (size_t i = queue.size() - used; i < queue.size(); ++i) queue[i] = gen.next();
 
         draw(board, score);
         std::this_thread::sleep_for(std::chrono::milliseconds(20));
     }
 
     draw(board, score);
-    std::wcout << L"\n========== GAME OVER ==========\n";
+    std::wcout << L"\n========== GAME OVER ==========\n" << reason << L'\n';
     std::wcout << L"Final Score: " << score << L'\n';
 #ifdef _WIN32
     system("pause");